@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2017, CATIE, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PWMCOMPENSATORG4_H
+#define PWMCOMPENSATORG4_H
+
+#define COMPENSATOR_MAX_ORDER       3
+#define COMPENSATOR_GUARD_BITS      2 // headroom of the 2p2z/3p3z accumulator, for 2 * MAX_ORDER + 1 terms
+#define DEFAULT_ADC_RESOLUTION     12
+
+#include "PwmOutG4.h"
+
+
+/*!
+ *  \class PwmCompensatorG4
+ *  Fixed-point (Q31) digital compensator writing its output directly to a PwmOutG4
+ *
+ *  Each call to update() takes one ADC sample, runs the filter and writes the duty-cycle
+ *  in HRTIM ticks, without any float operation. Output is saturated between the
+ *  duty-cycle min/max of the PwmOutG4, and the saturated value is the one kept in the
+ *  filter history (anti-windup).
+ */
+class PwmCompensatorG4 {
+
+public:
+
+    enum Type {
+        COMPENSATOR_PI = 0, //!< Proportional-integral, with clamped integrator
+        COMPENSATOR_2P2Z,   //!< 2p2z, "type II" compensator
+        COMPENSATOR_3P3Z    //!< 3p3z, "type III" compensator
+    };
+
+    /*!
+     *  Q31 coefficients, scaled by 2^-shift so that each one fits in [-1, 1[ (shift is at most 29)
+     *
+     *  Difference equation: u[n] = (sum b[i].e[n-i] + sum a[i].u[n-i]) * 2^shift
+     *  a[] is stored with the sign already inverted, a[0] is unused.
+     *  For the PI: b[0] is Kp and b[1] is Ki.Ts.
+     */
+    struct Coefficients {
+        int32_t b[COMPENSATOR_MAX_ORDER + 1];
+        int32_t a[COMPENSATOR_MAX_ORDER + 1];
+        uint8_t shift;
+    };
+
+    /*!
+     *  Default PwmCompensatorG4 constructor
+     *
+     *  @param pwm PwmOutG4 output driven by the compensator
+     *  @param type Compensator structure, see Type
+     *  @param coefficients Coefficients, see design helpers below
+     *  @param adc_resolution Resolution in bits of the ADC samples (default = 12)
+     */
+    PwmCompensatorG4(PwmOutG4 *pwm,
+                     Type type,
+                     const Coefficients &coefficients,
+                     uint8_t adc_resolution = DEFAULT_ADC_RESOLUTION);
+
+    ~PwmCompensatorG4();
+
+    /** Set the reference, in ADC units
+     *
+     * @param reference Setpoint, same unit and resolution as the ADC samples
+     */
+    void setReference(uint16_t reference);
+
+    /** Replace the coefficients, keeping the history
+     *
+     * @param coefficients New coefficients, of the same Type as given to the constructor
+     */
+    void setCoefficients(const Coefficients &coefficients);
+
+    /** Clear the filter history
+     *
+     * @param duty_cycle Duty-cycle in ticks to restart from (default = 0)
+     */
+    void reset(uint32_t duty_cycle = 0);
+
+    /** Run one compensator iteration and write the PWM
+     *
+     * Meant to be called from the ADC end of conversion interrupt.
+     *
+     * @param sample ADC sample of the regulated value
+     * @return Duty-cycle written to the PwmOutG4, in ticks
+     */
+    uint32_t update(uint16_t sample);
+
+
+    // Coefficient design helpers. Plant gain and phase are taken at the crossover frequency,
+    // with the plant normalized as (measure / ADC full scale) / (duty-cycle / 100%).
+
+    /** Design a PI for a given crossover frequency and phase margin
+     *
+     * @param bandwidth Crossover frequency, in Hz
+     * @param phase_margin Phase margin, in degrees
+     * @param plant_gain Plant gain at the crossover frequency
+     * @param plant_phase Plant phase at the crossover frequency, in degrees (negative)
+     * @param sampling_frequency Frequency in Hz of update() calls
+     */
+    static Coefficients designPI(float bandwidth, float phase_margin, float plant_gain, float plant_phase,
+                                 float sampling_frequency);
+
+    /** Design a 2p2z (type II) compensator, using the K-factor method
+     *
+     * Phase boost is limited to 90 degrees. Parameters are the same as designPI().
+     */
+    static Coefficients design2p2z(float bandwidth, float phase_margin, float plant_gain, float plant_phase,
+                                   float sampling_frequency);
+
+    /** Design a 3p3z (type III) compensator, using the K-factor method
+     *
+     * Phase boost is limited to 180 degrees. Parameters are the same as designPI().
+     */
+    static Coefficients design3p3z(float bandwidth, float phase_margin, float plant_gain, float plant_phase,
+                                   float sampling_frequency);
+
+private:
+
+    PwmOutG4 *_pwm;
+    Type _type;
+    Coefficients _coefficients;
+    uint8_t _adc_shift;
+    uint8_t _acc_shift;
+
+    uint16_t _reference;
+    uint32_t _period;
+    uint32_t _duty_cycle_min;
+    uint32_t _duty_cycle_max;
+
+    // Saturation of the output, Q31 fraction of the period
+    int32_t _u_min;
+    int32_t _u_max;
+
+    // History: errors in Q29, outputs in Q31 (see COMPENSATOR_GUARD_BITS). For the PI, _u[1] is the integrator.
+    int32_t _e[COMPENSATOR_MAX_ORDER + 1];
+    int32_t _u[COMPENSATOR_MAX_ORDER + 1];
+
+    static void checkDesign(float bandwidth, float plant_gain, float sampling_frequency);
+
+    static Coefficients quantize(const double *b, const double *a, int order);
+
+    static Coefficients designKFactor(int order, float bandwidth, float phase_margin, float plant_gain,
+                                      float plant_phase, float sampling_frequency);
+
+};
+
+
+#endif //PWMCOMPENSATORG4_H
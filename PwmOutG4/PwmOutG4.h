@@ -28,6 +28,9 @@
 
 #define ADC_TRIG_POSTSCALER 10
 
+#define CHOPPER_DEFAULT_DUTYCYCLE   0.5f
+#define CHOPPER_DEFAULT_STARTPULSE  0
+
 #include <mbed.h>
 
 
@@ -82,11 +85,45 @@ public:
      */
     void write(float pwm);
 
+    /** Set the output duty-cycle, specified directly in timer ticks
+     *
+     *  Fast path for control loops: no float conversion and no deadtime applied.
+     *
+     *  @param duty_cycle Compare value in HRTIM ticks. 0 stops the output, other values
+     *    are saturated between getDutyCycleMin() and getDutyCycleMax().
+     */
+    void writeTicks(uint32_t duty_cycle);
+
+    /** Get the period of the timer, in HRTIM ticks */
+    uint32_t getPeriod() const { return _period; }
+
+    /** Get the minimum non-null duty-cycle accepted by the HRTIM, in ticks */
+    uint32_t getDutyCycleMin() const { return _duty_cycle_min; }
+
+    /** Get the maximum duty-cycle accepted by the HRTIM, in ticks */
+    uint32_t getDutyCycleMax() const { return _duty_cycle_max; }
+
 
     // These functions does not relate from PwmOut MBED Object, and are specific to the use of HRTIM :
     void syncWith(PwmOutG4 *other);
     void syncWith(PwmOutG4 *other1, PwmOutG4 *other2);
 
+    /** Enable the HRTIM chopper on this output, to drive a gate transformer
+     *
+     * The PWM is ANDed with a high-frequency carrier generated by the HRTIM itself, write() is unchanged.
+     * Carrier settings are shared by both outputs of a timer: they belong to the first pin that enables the chopper,
+     * which can call it again to change them. The other output of the timer keeps them and ignores its arguments.
+     * THIS FUNCTION MUST BE CALLED BEFORE resume()
+     *
+     *  @param carrier_frequency Carrier frequency in Hz, from fHRTIM/256 to fHRTIM/16 (about 664kHz to 10.6MHz at 170MHz)
+     *  @param duty_cycle Carrier duty-cycle, from 0.0f to 0.875f by steps of 0.125f (default = 0.5f)
+     *  @param start_pulse Width in ns of the first pulse of each PWM period, from 16 to 256 tHRTIM.
+     *      0 selects the shortest one (default = 0)
+     */
+    void enableChopper(uint32_t carrier_frequency,
+                       float duty_cycle = CHOPPER_DEFAULT_DUTYCYCLE,
+                       uint32_t start_pulse = CHOPPER_DEFAULT_STARTPULSE);
+
 private:
 
     // Base HRTIM1 initialization : only one time
@@ -95,6 +132,9 @@ private:
     static bool _adctriggered_initialized;
     static uint8_t _tim_initialized[NUM_TIM_MAX];
     static uint8_t _tim_general_state[NUM_TIM_MAX];
+    static uint32_t _tim_frequency[NUM_TIM_MAX];
+    static uint8_t _tim_chopper_initialized[NUM_TIM_MAX];
+    static uint32_t _tim_chopper_frequency[NUM_TIM_MAX];
 
     static uint32_t _min_frequ_ckpsc[8];
 
@@ -105,6 +145,7 @@ private:
     uint32_t _duty_cycle;
     uint32_t _period;
     uint32_t _hrtim_prescal;
+    uint32_t _chopper_frequency;
 
     uint32_t _adc_update_src;
     uint32_t _adc_trig;
@@ -134,8 +175,12 @@ private:
 
     void setupPWMTimer();
 
+    void setupPWMCompare();
+
     void setupPWMOutput();
 
+    void setupChopper(uint32_t carrier_frequency, float duty_cycle, uint32_t start_pulse);
+
     void setupGPIO();
 
 };
@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2017, CATIE, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "PwmCompensatorG4.h"
+
+#define DEG_TO_RAD(x) ((x) * M_PI / 180.0)
+
+// Multiply polynomial p (in place, degree <= COMPENSATOR_MAX_ORDER - 1) by (c0 + c1.x)
+static void polyMul(double *p, int degree, double c0, double c1) {
+    for (int i = degree + 1; i > 0; i--) {
+        p[i] = p[i] * c0 + p[i - 1] * c1;
+    }
+    p[0] = p[0] * c0;
+}
+
+// Bilinear transform of a polynomial in s (ascending powers, given order) to a polynomial in z^-1,
+// with s = c.(1 - z^-1) / (1 + z^-1), both sides multiplied by (1 + z^-1)^order.
+static void bilinear(const double *s_poly, int order, double c, double *z_poly) {
+    double ck = 1.0;
+
+    for (int i = 0; i <= order; i++) {
+        z_poly[i] = 0.0;
+    }
+
+    for (int k = 0; k <= order; k++) {
+        double term[COMPENSATOR_MAX_ORDER + 1] = {1.0};
+        for (int i = 0; i < k; i++) {
+            polyMul(term, i, 1.0, -1.0);
+        }
+        for (int i = k; i < order; i++) {
+            polyMul(term, i, 1.0, 1.0);
+        }
+        for (int i = 0; i <= order; i++) {
+            z_poly[i] += s_poly[k] * ck * term[i];
+        }
+        ck *= c;
+    }
+}
+
+
+PwmCompensatorG4::PwmCompensatorG4(PwmOutG4 *pwm, Type type, const Coefficients &coefficients,
+                                   uint8_t adc_resolution) :
+        _pwm(pwm),
+        _type(type),
+        _reference(0) {
+
+    if ((adc_resolution == 0) || (adc_resolution > 16)) {
+        error("PwmCompensatorG4 ERROR: ADC resolution of %d bits is not supported (1 to 16 bits).\n",
+              adc_resolution);
+    }
+    _adc_shift = 31 - COMPENSATOR_GUARD_BITS - adc_resolution;
+
+    // Output saturation follows the PwmOutG4 limits, see PwmOutG4::setupFrequency().
+    // _u_min is rounded up so that the converted duty-cycle never falls below _duty_cycle_min.
+    _period = _pwm->getPeriod();
+    _duty_cycle_min = _pwm->getDutyCycleMin();
+    _duty_cycle_max = _pwm->getDutyCycleMax();
+    _u_min = (int32_t) ((((uint64_t) _duty_cycle_min << 31) + _period - 1) / _period);
+    _u_max = (int32_t) (((uint64_t) _duty_cycle_max << 31) / _period);
+
+    setCoefficients(coefficients);
+    reset();
+}
+
+PwmCompensatorG4::~PwmCompensatorG4() {
+
+}
+
+// Setters below share their state with update(), which runs in interrupt context:
+// they must not be preempted by it while the state is partially written.
+
+void PwmCompensatorG4::setReference(uint16_t reference) {
+    CriticalSectionLock lock;
+    _reference = reference;
+}
+
+void PwmCompensatorG4::setCoefficients(const Coefficients &coefficients) {
+    CriticalSectionLock lock;
+    _coefficients = coefficients;
+    _acc_shift = 31 - COMPENSATOR_GUARD_BITS - _coefficients.shift;
+}
+
+void PwmCompensatorG4::reset(uint32_t duty_cycle) {
+
+    int32_t u = (int32_t) (((uint64_t) duty_cycle << 31) / _period);
+    if (u < _u_min)
+        u = _u_min;
+    else if (u > _u_max)
+        u = _u_max;
+
+    CriticalSectionLock lock;
+    for (int i = 0; i <= COMPENSATOR_MAX_ORDER; i++) {
+        _e[i] = 0;
+        _u[i] = u;
+    }
+}
+
+uint32_t PwmCompensatorG4::update(uint16_t sample) {
+
+    // Error in Q29, ADC full scale being 1.0. Together with the outputs taken in Q29 below, each product
+    // stays under 2^60, so the 7 terms of the 3p3z can't overflow the 64 bits accumulator.
+    int32_t e = ((int32_t) _reference - (int32_t) sample) * (1 << _adc_shift);
+    const int32_t *b = _coefficients.b;
+    const int32_t *a = _coefficients.a;
+    int64_t u;
+
+    switch (_type) {
+        case COMPENSATOR_PI: {
+            // Integrator is clamped to the output range: no windup when saturated.
+            int64_t integral = _u[1] + (((int64_t) b[1] * e) >> _acc_shift);
+            if (integral < _u_min)
+                integral = _u_min;
+            else if (integral > _u_max)
+                integral = _u_max;
+            _u[1] = (int32_t) integral;
+
+            u = (((int64_t) b[0] * e) >> _acc_shift) + integral;
+            break;
+        }
+        case COMPENSATOR_2P2Z:
+            u = ((int64_t) b[0] * e
+                 + (int64_t) b[1] * _e[1] + (int64_t) b[2] * _e[2]
+                 + (int64_t) a[1] * (_u[1] >> COMPENSATOR_GUARD_BITS)
+                 + (int64_t) a[2] * (_u[2] >> COMPENSATOR_GUARD_BITS)) >> _acc_shift;
+            break;
+        default: // COMPENSATOR_3P3Z
+            u = ((int64_t) b[0] * e
+                 + (int64_t) b[1] * _e[1] + (int64_t) b[2] * _e[2] + (int64_t) b[3] * _e[3]
+                 + (int64_t) a[1] * (_u[1] >> COMPENSATOR_GUARD_BITS)
+                 + (int64_t) a[2] * (_u[2] >> COMPENSATOR_GUARD_BITS)
+                 + (int64_t) a[3] * (_u[3] >> COMPENSATOR_GUARD_BITS)) >> _acc_shift;
+            break;
+    }
+
+    if (u < _u_min)
+        u = _u_min;
+    else if (u > _u_max)
+        u = _u_max;
+
+    if (_type != COMPENSATOR_PI) {
+        // Keep the saturated output in the history (anti-windup)
+        _e[3] = _e[2];
+        _e[2] = _e[1];
+        _e[1] = e;
+        _u[3] = _u[2];
+        _u[2] = _u[1];
+        _u[1] = (int32_t) u;
+    }
+
+    // Same min/max as PwmOutG4::writeTicks(), so the returned value is the one written.
+    uint32_t duty_cycle = (uint32_t) (((uint64_t) u * _period) >> 31);
+    if (duty_cycle < _duty_cycle_min)
+        duty_cycle = _duty_cycle_min;
+    else if (duty_cycle > _duty_cycle_max)
+        duty_cycle = _duty_cycle_max;
+    _pwm->writeTicks(duty_cycle);
+
+    return duty_cycle;
+}
+
+PwmCompensatorG4::Coefficients PwmCompensatorG4::quantize(const double *b, const double *a, int order) {
+
+    Coefficients coefficients = {{0}, {0}, 0};
+    double max = 0.0;
+
+    for (int i = 0; i <= order; i++) {
+        if (fabs(b[i]) > max)
+            max = fabs(b[i]);
+        if ((i > 0) && (fabs(a[i]) > max))
+            max = fabs(a[i]);
+    }
+
+    // Smallest shift such that all coefficients fit in Q31. _acc_shift must stay positive.
+    while ((max >= (double) (1UL << coefficients.shift)) && (coefficients.shift < 31 - COMPENSATOR_GUARD_BITS)) {
+        coefficients.shift++;
+    }
+    if (max >= (double) (1UL << coefficients.shift)) {
+        printf("\nWarning PwmCompensatorG4: coefficients are too large and will be saturated.\n");
+    }
+
+    double scale = ldexp(1.0, 31 - coefficients.shift);
+    for (int i = 0; i <= order; i++) {
+        double qb = round(b[i] * scale);
+        double qa = (i > 0) ? round(a[i] * scale) : 0.0;
+        coefficients.b[i] = (int32_t) fmax(fmin(qb, (double) INT32_MAX), (double) INT32_MIN);
+        coefficients.a[i] = (int32_t) fmax(fmin(qa, (double) INT32_MAX), (double) INT32_MIN);
+    }
+
+    return coefficients;
+}
+
+void PwmCompensatorG4::checkDesign(float bandwidth, float plant_gain, float sampling_frequency) {
+
+    if (!(bandwidth > 0.0f)) {
+        error("PwmCompensatorG4 ERROR: bandwidth must be strictly positive.\n");
+    }
+    if (!(plant_gain > 0.0f)) {
+        error("PwmCompensatorG4 ERROR: plant gain must be strictly positive.\n");
+    }
+    if (bandwidth >= sampling_frequency / 2.0f) {
+        error("PwmCompensatorG4 ERROR: bandwidth (%dHz) must be lower than half the sampling frequency (%dHz).\n",
+              (int) bandwidth, (int) sampling_frequency);
+    }
+}
+
+PwmCompensatorG4::Coefficients PwmCompensatorG4::designPI(float bandwidth, float phase_margin, float plant_gain,
+                                                          float plant_phase, float sampling_frequency) {
+
+    checkDesign(bandwidth, plant_gain, sampling_frequency);
+
+    double wc = 2.0 * M_PI * bandwidth;
+
+    // PI phase at crossover is -atan(wi / wc), and must be between -90 and 0 degrees.
+    double phase = phase_margin - 180.0 - plant_phase;
+    if ((phase > 0.0) || (phase <= -90.0)) {
+        printf("\nWarning PwmCompensatorG4: phase margin of %d deg can't be reached with a PI.\n",
+               (int) phase_margin);
+        phase = (phase > 0.0) ? 0.0 : -89.0;
+    }
+
+    double wi = wc * tan(DEG_TO_RAD(-phase));
+    double kp = 1.0 / (plant_gain * sqrt(1.0 + (wi / wc) * (wi / wc)));
+
+    double b[COMPENSATOR_MAX_ORDER + 1] = {kp, kp * wi / sampling_frequency};
+    double a[COMPENSATOR_MAX_ORDER + 1] = {0};
+
+    return quantize(b, a, 1);
+}
+
+PwmCompensatorG4::Coefficients PwmCompensatorG4::design2p2z(float bandwidth, float phase_margin, float plant_gain,
+                                                            float plant_phase, float sampling_frequency) {
+    return designKFactor(2, bandwidth, phase_margin, plant_gain, plant_phase, sampling_frequency);
+}
+
+PwmCompensatorG4::Coefficients PwmCompensatorG4::design3p3z(float bandwidth, float phase_margin, float plant_gain,
+                                                            float plant_phase, float sampling_frequency) {
+    return designKFactor(3, bandwidth, phase_margin, plant_gain, plant_phase, sampling_frequency);
+}
+
+PwmCompensatorG4::Coefficients PwmCompensatorG4::designKFactor(int order, float bandwidth, float phase_margin,
+                                                               float plant_gain, float plant_phase,
+                                                               float sampling_frequency) {
+
+    checkDesign(bandwidth, plant_gain, sampling_frequency);
+
+    double wc = 2.0 * M_PI * bandwidth;
+    int n = order - 1; // number of zero/pole pairs
+
+    // Phase boost needed on top of the -90 degrees of the integrator. Each pair gives less than 90 degrees.
+    double boost = phase_margin - 90.0 - plant_phase;
+    if ((boost < 0.0) || (boost >= 90.0 * n)) {
+        printf("\nWarning PwmCompensatorG4: phase margin of %d deg can't be reached with a %dp%dz.\n",
+               (int) phase_margin, order, order);
+        boost = (boost < 0.0) ? 0.0 : 90.0 * n - 1.0;
+    }
+
+    // K-factor: zeros at wc / sqrt_k, poles at wc * sqrt_k
+    double sqrt_k = tan(DEG_TO_RAD(boost / (2.0 * n) + 45.0));
+    double wz = wc / sqrt_k;
+    double wp = wc * sqrt_k;
+
+    double magnitude = pow(sqrt(1.0 + (wc / wz) * (wc / wz)) / sqrt(1.0 + (wc / wp) * (wc / wp)), n) / wc;
+    double kc = 1.0 / (plant_gain * magnitude);
+
+    // C(s) = kc.(1 + s/wz)^n / (s.(1 + s/wp)^n)
+    double num_s[COMPENSATOR_MAX_ORDER + 1] = {kc};
+    double den_s[COMPENSATOR_MAX_ORDER + 1] = {0.0, 1.0};
+    for (int i = 0; i < n; i++) {
+        polyMul(num_s, i, 1.0, 1.0 / wz);
+        polyMul(den_s, i + 1, 1.0, 1.0 / wp);
+    }
+
+    // Bilinear transform, prewarped at the crossover frequency
+    double c = wc / tan(wc / (2.0 * sampling_frequency));
+    double num_z[COMPENSATOR_MAX_ORDER + 1];
+    double den_z[COMPENSATOR_MAX_ORDER + 1];
+    bilinear(num_s, order, c, num_z);
+    bilinear(den_s, order, c, den_z);
+
+    double b[COMPENSATOR_MAX_ORDER + 1];
+    double a[COMPENSATOR_MAX_ORDER + 1];
+    for (int i = 0; i <= order; i++) {
+        b[i] = num_z[i] / den_z[0];
+        a[i] = -den_z[i] / den_z[0];
+    }
+
+    return quantize(b, a, order);
+}
@@ -23,6 +23,9 @@ HRTIM_HandleTypeDef PwmOutG4::_hhrtim1;
 bool PwmOutG4::_hrtim_initialized = false, PwmOutG4::_adctriggered_initialized = false;
 uint8_t PwmOutG4::_tim_initialized[NUM_TIM_MAX] = {0};
 uint8_t PwmOutG4::_tim_general_state[NUM_TIM_MAX] = {0};
+uint32_t PwmOutG4::_tim_frequency[NUM_TIM_MAX] = {0};
+uint8_t PwmOutG4::_tim_chopper_initialized[NUM_TIM_MAX] = {0};
+uint32_t PwmOutG4::_tim_chopper_frequency[NUM_TIM_MAX] = {0};
 uint32_t PwmOutG4::_min_frequ_ckpsc[8] = {0};
 
 
@@ -31,6 +34,7 @@ PwmOutG4::PwmOutG4(PinName pin, uint32_t frequency, bool inverted, bool rollover
         _inverted(inverted),
         _rollover(rollover),
         _frequency(frequency),
+        _chopper_frequency(0),
         _deadtime(deadtime) {
 
     // Init specific registers regarding the PWMx_OUT for the STM32G474VET6
@@ -167,6 +171,7 @@ void PwmOutG4::initPWM() {
     }
 
     // Then init the PWM output
+    setupPWMCompare();
     setupPWMOutput();
     setupGPIO();
 //    resume(); NE PAS START ICI, sinon 2 sorties d'un même timer ne seront pas correct si l'une des 2 est inversée (ex. PB14 et PB15). À faire dans le main.cpp quand tout est initialisé.
@@ -299,6 +304,9 @@ void PwmOutG4::setupPWMTimer() {
     HRTIM_TimerCtlTypeDef pTimerCtl = {0};
     HRTIM_TimerCfgTypeDef pTimerCfg = {0};
 
+    // Keep the frequency the timer really runs at, for the pins sharing it.
+    _tim_frequency[_tim_idx] = _frequency;
+
     pTimeBaseCfg.Period = _period;
     pTimeBaseCfg.RepetitionCounter = 0x00;
     pTimeBaseCfg.PrescalerRatio = _hrtim_prescal;
@@ -356,16 +364,22 @@ void PwmOutG4::setupPWMTimer() {
 
 }
 
-void PwmOutG4::setupPWMOutput() {
+void PwmOutG4::setupPWMCompare() {
 
     HRTIM_CompareCfgTypeDef pCompareCfg = {0};
-    HRTIM_OutputCfgTypeDef pOutputCfg = {0};
 
     pCompareCfg.CompareValue = 0x0000;
     if (HAL_HRTIM_WaveformCompareConfig(&_hhrtim1, _tim_idx, _tim_cpr_unit, &pCompareCfg) !=
         HAL_OK) {
         printf("Error while configuring compare1 for HRTIM1 waveform.\n");
     }
+
+}
+
+void PwmOutG4::setupPWMOutput() {
+
+    HRTIM_OutputCfgTypeDef pOutputCfg = {0};
+
     if (_inverted)
         pOutputCfg.Polarity = HRTIM_OUTPUTPOLARITY_LOW;
     else
@@ -380,7 +394,10 @@ void PwmOutG4::setupPWMOutput() {
     pOutputCfg.IdleMode = HRTIM_OUTPUTIDLEMODE_NONE;
     pOutputCfg.IdleLevel = HRTIM_OUTPUTIDLELEVEL_INACTIVE;
     pOutputCfg.FaultLevel = HRTIM_OUTPUTFAULTLEVEL_NONE;
-    pOutputCfg.ChopperModeEnable = HRTIM_OUTPUTCHOPPERMODE_DISABLED;
+    if (_chopper_frequency != 0)
+        pOutputCfg.ChopperModeEnable = HRTIM_OUTPUTCHOPPERMODE_ENABLED;
+    else
+        pOutputCfg.ChopperModeEnable = HRTIM_OUTPUTCHOPPERMODE_DISABLED;
     pOutputCfg.BurstModeEntryDelayed = HRTIM_OUTPUTBURSTMODEENTRY_REGULAR;
     if (HAL_HRTIM_WaveformOutputConfig(&_hhrtim1, _tim_idx, _tim_output, &pOutputCfg) != HAL_OK) {
         printf("Error while configuring TIMER HRTIM1 waveform output.\n");
@@ -388,6 +405,65 @@ void PwmOutG4::setupPWMOutput() {
 
 }
 
+void PwmOutG4::setupChopper(uint32_t carrier_frequency, float duty_cycle, uint32_t start_pulse) {
+
+    HRTIM_ChopperModeCfgTypeDef pChopperModeCfg = {0};
+    uint32_t fhrtim = SystemCoreClock;
+    uint32_t frequency = _tim_frequency[_tim_idx]; // may differ from _frequency if the timer is shared
+
+    // See "Chopper" part of the HRTIM chapter of STM32G4 reference manual.
+    // Carrier frequency: fHRTIM / (16 * (CARFRQ + 1)), CARFRQ from 0 to 15.
+    if (carrier_frequency == 0) {
+        error("PwmOutG4 ERROR: chopper frequency of pin %d can't be 0Hz.\n", _pin);
+    }
+    // Rounded divider, computed in integer: no overflow or division by zero.
+    uint64_t divider = ((uint64_t) fhrtim + 8 * (uint64_t) carrier_frequency) / (16 * (uint64_t) carrier_frequency);
+    uint32_t carfrq;
+    if (divider < 1) {
+        carfrq = 0;
+    } else if (divider > 16) {
+        carfrq = 15;
+    } else {
+        carfrq = (uint32_t) divider - 1;
+    }
+    if ((divider < 1) || (divider > 16)) {
+        printf("\nWarning PwmOutG4: chopper frequency of %luHz is out of range. Pin %d will use %luHz.\n",
+               carrier_frequency, _pin, fhrtim / (16 * (carfrq + 1)));
+    }
+    _chopper_frequency = fhrtim / (16 * (carfrq + 1));
+
+    // The carrier must be faster than the PWM, else the output is only made of start pulses.
+    if (_chopper_frequency <= frequency) {
+        error("PwmOutG4 ERROR: chopper frequency (%luHz) must be higher than the PWM frequency (%luHz) on pin %d.\n",
+              _chopper_frequency, frequency, _pin);
+    }
+
+    // Carrier duty cycle: CARDTY / 8, CARDTY from 0 to 7.
+    if (duty_cycle > 0.875f)
+        duty_cycle = 0.875f;
+    else if (duty_cycle < 0.0f)
+        duty_cycle = 0.0f;
+    uint32_t cardty = (uint32_t) ((duty_cycle * 8.0f) + 0.5f);
+
+    // Start pulse: 16 * (STRPW + 1) tHRTIM, STRPW from 0 to 15.
+    int32_t strpw = (int32_t) ((((float) start_pulse * 1e-9f * (float) fhrtim) / 16.0f) + 0.5f) - 1;
+    if (strpw < 0)
+        strpw = 0;
+    else if (strpw > 15)
+        strpw = 15;
+    if ((uint64_t) 16 * (strpw + 1) * frequency >= fhrtim) {
+        printf("\nWarning PwmOutG4: chopper start pulse of pin %d is longer than the PWM period.\n", _pin);
+    }
+
+    pChopperModeCfg.CarrierFreq = carfrq << HRTIM_CHPR_CARFRQ_Pos;
+    pChopperModeCfg.DutyCycle = cardty << HRTIM_CHPR_CARDTY_Pos;
+    pChopperModeCfg.StartPulse = (uint32_t) strpw << HRTIM_CHPR_STRPW_Pos;
+    if (HAL_HRTIM_ChopperModeConfig(&_hhrtim1, _tim_idx, &pChopperModeCfg) != HAL_OK) {
+        printf("Error while configuring HRTIM1 chopper.\n");
+    }
+
+}
+
 void PwmOutG4::setupGPIO() {
 
     // init gpio struct
@@ -398,11 +474,13 @@ void PwmOutG4::setupGPIO() {
 
     // Setup the right speed corresponding to the Frequency.
     // This will improve signal quality (because higher frequency = higher speed = higher EMI noise due to higher switching current peak)
-    if (_frequency < 5000000) { // <5 MhZ
+    // When the chopper is enabled, the carrier is the fastest signal on the pin.
+    uint32_t frequency = (_chopper_frequency > _frequency) ? _chopper_frequency : _frequency;
+    if (frequency < 5000000) { // <5 MhZ
         GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
-    } else if (_frequency < 25000000) { // between 5Mhz and 25MhZ
+    } else if (frequency < 25000000) { // between 5Mhz and 25MhZ
         GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_MEDIUM;
-    } else if (_frequency < 50000000) { // between 25Mhz and 50MhZ
+    } else if (frequency < 50000000) { // between 25Mhz and 50MhZ
         GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
     } else { // more than 50Mhz
         GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
@@ -489,6 +567,44 @@ void PwmOutG4::write(float pwm) {
             __HAL_HRTIM_SetCompare(&_hhrtim1, _tim_idx, _tim_cpr_unit, _duty_cycle);
 }
 
+void PwmOutG4::writeTicks(uint32_t duty_cycle) {
+
+    // Same min/max security as write(), see setupFrequency() function.
+    if (duty_cycle == 0x0000)
+        _duty_cycle = 0x0000;
+    else if (duty_cycle < _duty_cycle_min)
+        _duty_cycle = _duty_cycle_min;
+    else if (duty_cycle > _duty_cycle_max)
+        _duty_cycle = _duty_cycle_max;
+    else
+        _duty_cycle = duty_cycle;
+
+    __HAL_HRTIM_SetCompare(&_hhrtim1, _tim_idx, _tim_cpr_unit, _duty_cycle);
+}
+
+
+void PwmOutG4::enableChopper(uint32_t carrier_frequency, float duty_cycle, uint32_t start_pulse) {
+
+    // Chopper settings belong to the timer, so they are shared with the other output of the same timer.
+    // Only the pin which first set them up can change them.
+    if ((_tim_chopper_initialized[_tim_idx] != 0) && (_tim_chopper_initialized[_tim_idx] != _pin)) {
+        printf("\nWarning PwmOutG4: chopper of timer %lu has already been initialized by pin %d, and can't be setup again.\n",
+               _tim_idx, _tim_chopper_initialized[_tim_idx]);
+        printf("Warning PwmOutG4: so pin %d ignores the requested carrier and keeps the %luHz carrier of pin %d.\n",
+               _pin, _tim_chopper_frequency[_tim_idx], _tim_chopper_initialized[_tim_idx]);
+        _chopper_frequency = _tim_chopper_frequency[_tim_idx];
+    } else {
+        setupChopper(carrier_frequency, duty_cycle, start_pulse);
+        _tim_chopper_frequency[_tim_idx] = _chopper_frequency;
+        _tim_chopper_initialized[_tim_idx] = _pin;
+    }
+
+    // Then enable the chopper on the output itself. The compare unit is left untouched,
+    // so a duty-cycle already set by write() is kept.
+    setupPWMOutput();
+    setupGPIO();
+}
+
 
 // Quick HACK to sync different timers (PWM output) when they have the same frequency.
 // Only work after starting both PWM.
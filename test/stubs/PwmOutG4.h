@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2017, CATIE, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Host replacement of PwmOutG4, forced-included before the real header (same include guard).
+#ifndef PWMOUTG4_H
+#define PWMOUTG4_H
+
+#include "mbed.h"
+
+/*!
+ *  \class PwmOutG4
+ *  Records the last duty-cycle written, with the limits of a 170kHz timer at MUL32 prescaler (see PwmOutG4::setupFrequency()).
+ */
+class PwmOutG4 {
+
+public:
+
+    PwmOutG4(uint32_t period = 0x7D00, uint32_t duty_cycle_min = 0x0060, uint32_t duty_cycle_max = 0x7CE0) :
+            _duty_cycle(0),
+            _period(period),
+            _duty_cycle_min(duty_cycle_min),
+            _duty_cycle_max(duty_cycle_max) {
+    }
+
+    void writeTicks(uint32_t duty_cycle) { _duty_cycle = duty_cycle; }
+
+    uint32_t getPeriod() const { return _period; }
+
+    uint32_t getDutyCycleMin() const { return _duty_cycle_min; }
+
+    uint32_t getDutyCycleMax() const { return _duty_cycle_max; }
+
+    uint32_t getDutyCycle() const { return _duty_cycle; }
+
+private:
+
+    uint32_t _duty_cycle;
+    uint32_t _period;
+    uint32_t _duty_cycle_min;
+    uint32_t _duty_cycle_max;
+
+};
+
+#endif //PWMOUTG4_H
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2017, CATIE, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef MBED_H
+#define MBED_H
+
+// Minimal host replacement of mbed.h, only what PwmCompensatorG4 needs.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#define error(...) do { printf(__VA_ARGS__); exit(1); } while (0)
+
+// Interrupts don't exist on host: nothing to mask.
+class CriticalSectionLock {
+public:
+    CriticalSectionLock() {}
+    ~CriticalSectionLock() {}
+};
+
+#endif //MBED_H
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2017, CATIE, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Host test of PwmCompensatorG4: step response of a voltage-mode buck, averaged model.
+
+#include "PwmCompensatorG4.h"
+
+// Buck converter
+#define VIN             12.0
+#define INDUCTANCE      22e-6
+#define CAPACITANCE     100e-6
+#define LOAD            1.0
+
+// Voltage measurement: divider by 2, 12 bits ADC with 3.3V reference
+#define SENSOR_GAIN     0.5
+#define ADC_VREF        3.3
+#define ADC_FULL_SCALE  4096
+
+#define SAMPLING_FREQUENCY  100000.0
+#define SIMULATION_STEPS    50 // plant integration steps per sample
+#define SIMULATION_TIME     0.05
+
+#define SETPOINT            3.3
+#define SETTLING_BAND       0.02
+
+static int failures = 0;
+
+// Plant gain and phase (degrees) at frequency, normalized as (measure / ADC full scale) / duty-cycle
+static void plantResponse(double frequency, float *gain, float *phase) {
+    double w = 2.0 * M_PI * frequency;
+    double dc_gain = VIN * SENSOR_GAIN / ADC_VREF;
+    double re = 1.0 - w * w * INDUCTANCE * CAPACITANCE;
+    double im = w * INDUCTANCE / LOAD;
+
+    *gain = (float) (dc_gain / sqrt(re * re + im * im));
+    *phase = (float) (-atan2(im, re) * 180.0 / M_PI);
+}
+
+static void check(bool condition, const char *name, const char *message, double value) {
+    printf("  %-6s %-32s %8.4f  %s\n", name, message, value, condition ? "OK" : "FAIL");
+    if (!condition)
+        failures++;
+}
+
+static void testStepResponse(const char *name, PwmCompensatorG4::Type type,
+                             const PwmCompensatorG4::Coefficients &coefficients,
+                             double max_overshoot, double max_settling_time) {
+
+    PwmOutG4 pwm;
+    PwmCompensatorG4 compensator(&pwm, type, coefficients);
+    compensator.setReference((uint16_t) (SETPOINT * SENSOR_GAIN / ADC_VREF * ADC_FULL_SCALE + 0.5));
+
+    double il = 0.0, vout = 0.0, peak = 0.0, settling_time = 0.0;
+    double dt = 1.0 / (SAMPLING_FREQUENCY * SIMULATION_STEPS);
+    int samples = (int) (SIMULATION_TIME * SAMPLING_FREQUENCY);
+    bool limits_ok = true;
+
+    for (int n = 0; n < samples; n++) {
+        double adc = vout * SENSOR_GAIN / ADC_VREF * ADC_FULL_SCALE;
+        uint16_t sample = (uint16_t) fmin(fmax(adc, 0.0), ADC_FULL_SCALE - 1);
+
+        uint32_t duty_cycle = compensator.update(sample);
+        if ((duty_cycle != pwm.getDutyCycle()) || (duty_cycle < pwm.getDutyCycleMin())
+            || (duty_cycle > pwm.getDutyCycleMax()))
+            limits_ok = false;
+
+        // Averaged model, semi-implicit Euler
+        double vsw = VIN * (double) duty_cycle / (double) pwm.getPeriod();
+        for (int i = 0; i < SIMULATION_STEPS; i++) {
+            il += (vsw - vout) / INDUCTANCE * dt;
+            vout += (il - vout / LOAD) / CAPACITANCE * dt;
+        }
+
+        if (vout > peak)
+            peak = vout;
+        if (fabs(vout - SETPOINT) > SETTLING_BAND * SETPOINT)
+            settling_time = (n + 1) / SAMPLING_FREQUENCY;
+    }
+
+    printf("%s:\n", name);
+    check(limits_ok, name, "duty-cycle written within limits", 1.0);
+    check(fabs(vout - SETPOINT) < 0.01 * SETPOINT, name, "final value (V)", vout);
+    check((peak - SETPOINT) / SETPOINT < max_overshoot, name, "overshoot (%)", 100.0 * (peak - SETPOINT) / SETPOINT);
+    check(settling_time < max_settling_time, name, "settling time at 2% (ms)", 1000.0 * settling_time);
+}
+
+// Full-scale error reversal, compared to the same filter computed in double: a wrapped accumulator
+// would send the output to the opposite rail.
+static void testErrorReversal(const char *name, PwmCompensatorG4::Type type,
+                              const PwmCompensatorG4::Coefficients &coefficients) {
+
+    PwmOutG4 pwm;
+    PwmCompensatorG4 compensator(&pwm, type, coefficients);
+
+    double scale = ldexp(1.0, coefficients.shift - 31);
+    double u_min = (double) pwm.getDutyCycleMin() / pwm.getPeriod();
+    double u_max = (double) pwm.getDutyCycleMax() / pwm.getPeriod();
+    double e[COMPENSATOR_MAX_ORDER + 1] = {0};
+    double u[COMPENSATOR_MAX_ORDER + 1] = {u_min, u_min, u_min, u_min};
+    int order = (type == PwmCompensatorG4::COMPENSATOR_2P2Z) ? 2 : 3;
+    double max_error = 0.0;
+
+    for (int n = 0; n < 30; n++) {
+        uint16_t reference = (n < 5) ? ADC_FULL_SCALE - 1 : 0;
+        uint16_t sample = (n < 5) ? 0 : ADC_FULL_SCALE - 1;
+        compensator.setReference(reference);
+        uint32_t duty_cycle = compensator.update(sample);
+
+        for (int i = order; i > 0; i--) {
+            e[i] = e[i - 1];
+            u[i] = u[i - 1];
+        }
+        e[0] = ((double) reference - (double) sample) / ADC_FULL_SCALE;
+        u[0] = 0.0;
+        for (int i = 0; i <= order; i++) {
+            u[0] += coefficients.b[i] * scale * e[i] + coefficients.a[i] * scale * u[i];
+        }
+        u[0] = fmin(fmax(u[0], u_min), u_max);
+
+        max_error = fmax(max_error, fabs((double) duty_cycle - u[0] * pwm.getPeriod()));
+    }
+
+    printf("%s:\n", name);
+    check(max_error < 2.0, name, "reversal error to reference (ticks)", max_error);
+}
+
+int main() {
+
+    float gain, phase;
+
+    plantResponse(300.0, &gain, &phase);
+    testStepResponse("PI", PwmCompensatorG4::COMPENSATOR_PI,
+                     PwmCompensatorG4::designPI(300.0f, 100.0f, gain, phase, SAMPLING_FREQUENCY),
+                     0.05, 0.005);
+
+    plantResponse(3000.0, &gain, &phase);
+    testStepResponse("2p2z", PwmCompensatorG4::COMPENSATOR_2P2Z,
+                     PwmCompensatorG4::design2p2z(3000.0f, 60.0f, gain, phase, SAMPLING_FREQUENCY),
+                     0.20, 0.005);
+
+    plantResponse(8000.0, &gain, &phase);
+    testStepResponse("3p3z", PwmCompensatorG4::COMPENSATOR_3P3Z,
+                     PwmCompensatorG4::design3p3z(8000.0f, 50.0f, gain, phase, SAMPLING_FREQUENCY),
+                     0.20, 0.002);
+
+    plantResponse(3000.0, &gain, &phase);
+    testErrorReversal("2p2z", PwmCompensatorG4::COMPENSATOR_2P2Z,
+                      PwmCompensatorG4::design2p2z(3000.0f, 60.0f, gain, phase, SAMPLING_FREQUENCY));
+    plantResponse(8000.0, &gain, &phase);
+    testErrorReversal("3p3z", PwmCompensatorG4::COMPENSATOR_3P3Z,
+                      PwmCompensatorG4::design3p3z(8000.0f, 50.0f, gain, phase, SAMPLING_FREQUENCY));
+
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}